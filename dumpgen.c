@@ -11,6 +11,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
 #include <unistd.h>
 
 #define IOCTL_IDENT 'G'
@@ -48,6 +51,147 @@
 
 #define DELAY 50
 
+#define DEFAULT_TELEMETRY_INTERVAL 1000
+
+typedef struct {
+	const char *phase;
+	double   start;
+	double   phase_start;
+	double   last_time;
+	double   dump_start;
+	uint64_t handshakes;
+	uint64_t wait_polls;
+	uint32_t max_wait_polls;
+	uint32_t bytes;
+	uint32_t total;
+	uint32_t last_bytes;
+	uint32_t prev_bytes; //bytes from earlier phases of the dump
+	uint32_t interval;
+	int      fd;
+} telemetry;
+
+telemetry stats = {
+	.phase = "init",
+	.interval = DEFAULT_TELEMETRY_INTERVAL,
+	.fd = -1
+};
+
+double now_seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//Writes a single newline-delimited JSON record to the telemetry fd
+void telemetry_report(double now)
+{
+	char line[512];
+	double elapsed = now - stats.phase_start;
+	double delta = now - stats.last_time;
+	double rate = delta > 0 ? (stats.bytes - stats.last_bytes) / delta : 0;
+	double avg_rate = elapsed > 0 ? stats.bytes / elapsed : 0;
+	double eta = avg_rate > 0 && stats.total > stats.bytes ? (stats.total - stats.bytes) / avg_rate : 0;
+	int len = snprintf(line, sizeof(line),
+		"{\"time\":%.3f,\"phase\":\"%s\",\"bytes\":%u,\"total\":%u,\"rate\":%.1f,\"avg_rate\":%.1f,\"eta\":%.1f,"
+		"\"handshakes\":%llu,\"wait_polls\":%llu,\"max_wait_polls\":%u}\n",
+		now - stats.start, stats.phase, stats.bytes, stats.total, rate, avg_rate, eta,
+		(unsigned long long)stats.handshakes, (unsigned long long)stats.wait_polls, stats.max_wait_polls
+	);
+	if (write(stats.fd, line, len) != len) {
+		//don't let a dead telemetry consumer interrupt a dump
+		stats.fd = -1;
+	}
+	stats.last_time = now;
+	stats.last_bytes = stats.bytes;
+}
+
+void telemetry_phase(const char *phase, uint32_t total)
+{
+	if (stats.fd < 0) {
+		return;
+	}
+	double now = now_seconds();
+	//make sure the last record of a phase has its final byte count
+	if (stats.bytes != stats.last_bytes) {
+		telemetry_report(now);
+	}
+	stats.prev_bytes += stats.bytes;
+	stats.phase = phase;
+	stats.phase_start = stats.last_time = now;
+	stats.bytes = stats.last_bytes = 0;
+	stats.total = total;
+	telemetry_report(now);
+}
+
+//starts the dump phase before the header is read so it counts towards the rate
+void telemetry_dump(void)
+{
+	telemetry_phase("dump", 0);
+	stats.dump_start = stats.phase_start;
+	stats.prev_bytes = 0;
+}
+
+//the total isn't known until the header has been read
+void telemetry_total(uint32_t total)
+{
+	stats.total = total;
+}
+
+void telemetry_progress(uint32_t bytes)
+{
+	if (stats.fd < 0) {
+		return;
+	}
+	stats.bytes = bytes;
+	double now = now_seconds();
+	if ((now - stats.last_time) * 1000 >= stats.interval || bytes == stats.total) {
+		telemetry_report(now);
+	}
+}
+
+//final record covers every data phase since telemetry_dump
+void telemetry_done(void)
+{
+	if (stats.fd < 0) {
+		return;
+	}
+	double now = now_seconds();
+	if (stats.bytes != stats.last_bytes) {
+		telemetry_report(now);
+	}
+	stats.phase = "done";
+	stats.bytes += stats.prev_bytes;
+	stats.last_bytes = stats.bytes;
+	stats.total = stats.bytes;
+	stats.phase_start = stats.dump_start;
+	telemetry_report(now);
+}
+
+void telemetry_error(void)
+{
+	if (stats.fd >= 0) {
+		stats.phase = "error";
+		telemetry_report(now_seconds());
+	}
+}
+
+void open_telemetry(char *dest)
+{
+	char *end;
+	long fd = strtol(dest, &end, 10);
+	if (*end) {
+		fd = open(dest, O_WRONLY | O_CREAT | O_APPEND, 0664);
+	}
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s for telemetry\n", dest);
+		exit(1);
+	}
+	signal(SIGPIPE, SIG_IGN);
+	stats.fd = fd;
+	stats.start = now_seconds();
+}
+
 
 void enable_gpio(int fd)
 {
@@ -323,27 +467,43 @@ void write_magic(int fd, int flag)
 	write_byte(fd, flag ? 1 : 0);
 }
 
-uint8_t read_byte(int fd)
+//Handshakes a single byte off the data bus, the bus must already be set for reads
+static inline uint8_t read_strobe(int fd)
 {
-	set_dir_read(fd);
 	clear_busy(fd);
 	usleep(DELAY);
-	int i = 0;
-	if (1000 == wait_low(fd, CPU_INIT_B, 1000)) {
+	int low = wait_low(fd, CPU_INIT_B, 1000);
+	if (1000 == low) {
+		telemetry_error();
 		fputs("timed out wiating for data (low)\n", stderr);
 		unlock_port(fd, GPIO_PORT_FPGA);
 		exit(1);
 	}
 	uint8_t ret = get_bits(fd, GPIO_PORT_FPGA, 0xFF);
 	set_busy(fd);
-	if (1000 == wait_high(fd, CPU_INIT_B, 1000)) {
+	int high = wait_high(fd, CPU_INIT_B, 1000);
+	if (1000 == high) {
+		telemetry_error();
 		fputs("timed out wiating for data (high)\n", stderr);
 		unlock_port(fd, GPIO_PORT_FPGA);
 		exit(1);
 	}
+	//each wait does one more poll than it returns
+	uint32_t polls = low + high + 2;
+	stats.handshakes++;
+	stats.wait_polls += polls;
+	if (polls > stats.max_wait_polls) {
+		stats.max_wait_polls = polls;
+	}
 	return ret;
 }
 
+uint8_t read_byte(int fd)
+{
+	set_dir_read(fd);
+	return read_strobe(fd);
+}
+
 uint16_t read_u16le(int fd)
 {
 	uint8_t lsb = read_byte(fd);
@@ -357,33 +517,46 @@ uint16_t cart_status(int fd)
 	return read_u16le(fd);
 }
 
-void read_range(int fd, uint8_t *dst, uint32_t start, uint32_t len)
+//start is in units of the bus width, len is always in bytes
+void start_range(int fd, uint32_t start, uint32_t len)
 {
 	write_byte(fd, 8);
 	write_u32le(fd, start);
 	write_byte(fd, 0xC);
 	write_u32le(fd, len-1);
 	write_byte(fd, 0x10);
-	for (; len > 0; len--, dst++)
-	{
-		*dst = read_byte(fd);
-	}
+	set_dir_read(fd);
 }
 
-void read_range_swapped(int fd, uint8_t *dst, uint32_t start, uint32_t len)
-{
-	write_byte(fd, 8);
-	write_u32le(fd, start/2);
-	write_byte(fd, 0xC);
-	write_u32le(fd, len-1);
-	write_byte(fd, 0x10);
-	for (; len > 0; len-=2, dst+=2)
-	{
-		dst[1] = read_byte(fd);
-		*dst = read_byte(fd);
-	}
+//Range reads are generated per bus width and byte order and share the
+//command setup in start_range
+#define DEFINE_READ_RANGE8(name) \
+void name(int fd, uint8_t *dst, uint32_t start, uint32_t len) \
+{ \
+	start_range(fd, start, len); \
+	for (uint8_t *end = dst + len; dst < end; dst++) \
+	{ \
+		*dst = read_strobe(fd); \
+	} \
 }
 
+//first and second are the destination offsets of the two bytes of each word
+//in the order they come off the bus, len must be even
+#define DEFINE_READ_RANGE16(name, first, second) \
+void name(int fd, uint8_t *dst, uint32_t start, uint32_t len) \
+{ \
+	start_range(fd, start/2, len); \
+	for (uint8_t *end = dst + len; dst < end; dst += 2) \
+	{ \
+		dst[first] = read_strobe(fd); \
+		dst[second] = read_strobe(fd); \
+	} \
+}
+
+DEFINE_READ_RANGE8(read_range)
+//Mega Drive carts are 16-bit big endian
+DEFINE_READ_RANGE16(read_range_swapped, 1, 0)
+
 void do_verify_setup(int fd)
 {
 	set_dir_read(fd);
@@ -457,14 +630,153 @@ void set_leds(int fd, int value)
 	set_dir_read(fd);
 }
 
-#define SSF2 "SUPER STREET FIGHTER2"
+//Mega Drive header fields
+#define HEADER_NAME 0x120
+#define HEADER_ROM_END 0x1A4
+#define HEADER_SRAM_MAGIC 0x1B0
+#define HEADER_SRAM_TYPE 0x1B2
+#define HEADER_SRAM_START 0x1B4
+#define HEADER_SRAM_END 0x1B8
+
+#define SRAM_MAGIC "RA"
+#define SRAM_LANES(type) ((type) >> 3 & 3)
+#define SRAM_LANES_EVEN 2
+#define SRAM_LANES_ODD 3
+#define SRAM_MAX_SIZE (1024*1024)
+#define SRAM_SUFFIX ".srm"
+
+#define MD_ADDR_SPACE (4*1024*1024)
+
+//Carts whose header doesn't give the real ROM size
+//the FPGA reads these linearly past 4MB, as dumpgen has always done for SSF2
+typedef struct {
+	char     *match;
+	uint32_t offset;
+	uint32_t rom_size;
+} size_rule;
+
+size_rule size_rules[] = {
+	//SSF2 reports a 4MB ROM in its header even though it is 5MB
+	{"SUPER STREET FIGHTER2", HEADER_NAME, 5*1024*1024}
+};
+
+typedef struct {
+	uint32_t rom_size;
+	uint32_t sram_start;
+	uint32_t sram_bus_size;
+	uint32_t sram_size;
+	uint8_t  sram_lanes;
+} dump_plan;
 
 uint8_t buffer[0x800];
 
+uint32_t header_u32(uint8_t *off)
+{
+	return off[0] << 24 | off[1] << 16 | off[2] << 8 | off[3];
+}
+
+void plan_dump(uint8_t *header, int force_size, dump_plan *plan)
+{
+	memset(plan, 0, sizeof(dump_plan));
+	uint32_t length = header_u32(header + HEADER_ROM_END) + 1;
+	plan->rom_size = length;
+	int matched = 0;
+	for (int i = 0; i < sizeof(size_rules)/sizeof(*size_rules); i++)
+	{
+		if (!memcmp(header + size_rules[i].offset, size_rules[i].match, strlen(size_rules[i].match))) {
+			plan->rom_size = size_rules[i].rom_size;
+			matched = 1;
+			break;
+		}
+	}
+	if (!matched && plan->rom_size > MD_ADDR_SPACE && force_size < 0) {
+		force_size = MD_ADDR_SPACE;
+	}
+	if (force_size >= 0) {
+		fprintf(stderr, "Size of %d bytes read from header, forcing %d\n", length, force_size);
+		plan->rom_size = force_size;
+	}
+	
+	if (!memcmp(header + HEADER_SRAM_MAGIC, SRAM_MAGIC, strlen(SRAM_MAGIC))) {
+		uint32_t start = header_u32(header + HEADER_SRAM_START) & ~1;
+		uint32_t end = header_u32(header + HEADER_SRAM_END) | 1;
+		if (start < plan->rom_size) {
+			//reading this needs the SRAM enable register at $A130F1 which dumpgen can't write yet
+			fprintf(stderr, "SRAM at %X overlaps ROM, skipping SRAM dump\n", start);
+		} else if (end > start && end - start < SRAM_MAX_SIZE) {
+			plan->sram_start = start;
+			plan->sram_bus_size = end - start + 1;
+			plan->sram_lanes = SRAM_LANES(header[HEADER_SRAM_TYPE]);
+			if (plan->sram_lanes == SRAM_LANES_EVEN || plan->sram_lanes == SRAM_LANES_ODD) {
+				plan->sram_size = plan->sram_bus_size / 2;
+			} else {
+				plan->sram_size = plan->sram_bus_size;
+			}
+		} else {
+			fprintf(stderr, "Ignoring invalid SRAM range %X-%X\n", start, end);
+		}
+	}
+}
+
+void dump_range(int fd, int outfd, uint32_t address, uint32_t len, uint32_t *done, uint32_t total)
+{
+	for (uint32_t end = address + len; address < end; address += sizeof(buffer))
+	{
+		printf("\r%d%%", (int)(100ULL * *done / total));
+		fflush(stdout);
+		uint32_t size = sizeof(buffer) < end-address ? sizeof(buffer) : end-address;
+		read_range_swapped(fd, buffer, address, size);
+		write(outfd, buffer, size);
+		*done += size;
+		telemetry_progress(*done);
+	}
+}
+
+void dump_rom(int fd, int outfd, dump_plan *plan)
+{
+	uint32_t done = sizeof(buffer) < plan->rom_size ? sizeof(buffer) : plan->rom_size;
+	write(outfd, buffer, done);
+	telemetry_total(plan->rom_size);
+	telemetry_progress(done);
+	dump_range(fd, outfd, done, plan->rom_size - done, &done, plan->rom_size);
+}
+
+void dump_sram(int fd, int outfd, dump_plan *plan)
+{
+	telemetry_phase("sram", plan->sram_size);
+	uint32_t done = 0;
+	for (uint32_t offset = 0; offset < plan->sram_bus_size; offset += sizeof(buffer))
+	{
+		uint32_t size = sizeof(buffer) < plan->sram_bus_size-offset ? sizeof(buffer) : plan->sram_bus_size-offset;
+		read_range_swapped(fd, buffer, plan->sram_start + offset, size);
+		if (plan->sram_lanes == SRAM_LANES_EVEN || plan->sram_lanes == SRAM_LANES_ODD) {
+			uint32_t lane = plan->sram_lanes == SRAM_LANES_ODD;
+			for (uint32_t i = 0; i < size/2; i++)
+			{
+				buffer[i] = buffer[i*2 + lane];
+			}
+			size /= 2;
+		}
+		write(outfd, buffer, size);
+		done += size;
+		telemetry_progress(done);
+	}
+}
+
 int main(int argc, char ** argv)
 {
+	while (argc > 2 && (!strcmp(argv[1], "-t") || !strcmp(argv[1], "-i")))
+	{
+		if (argv[1][1] == 't') {
+			open_telemetry(argv[2]);
+		} else {
+			stats.interval = atoi(argv[2]);
+		}
+		argv += 2;
+		argc -= 2;
+	}
 	if (argc < 2) {
-		fputs("Usage: dumpgen FILE\n", stderr);
+		fputs("Usage: dumpgen [-t FD|FILE] [-i MS] FILE\n", stderr);
 		exit(1);
 	}
 	int retron = open("/dev/retron5", O_RDWR | O_SYNC);
@@ -476,11 +788,11 @@ int main(int argc, char ** argv)
 	int outfd = -1;
 	int force_size = -1;
 	int do_led = 0;
+	char *fname = NULL;
 	if (strcmp(argv[1], "-s")) {
 		if (!strcmp(argv[1], "-l")) {
 			do_led = 1;
 		} else {
-			char *fname;
 			if (!strcmp(argv[1], "-f")) {
 				if (argc < 4) {
 					fputs("-f must be followed by size and destination filename\n", stderr);
@@ -509,11 +821,13 @@ int main(int argc, char ** argv)
 	puts("locking FPGA port");
 	lock_port(retron, GPIO_PORT_FPGA);
 		puts("Loading FPGA bitstream");
+		telemetry_phase("config", 0);
 		load_config(retron, "/mnt/sdcard/retron.fpga");
 	
 		puts("Setting pin direction");
 		set_bits(retron, GPIO_PORT_FPGA, 0xFAFF, 0XFAFF);
 		set_gpio_dir(retron, GPIO_PORT_FPGA, CPU_DOUT_BUSY | CPU_INIT_B, CPU_DOUT_BUSY);
+		telemetry_phase("verify", 0);
 		verify_fpga(retron);
 		
 		
@@ -526,27 +840,26 @@ int main(int argc, char ** argv)
 			puts("Setting up for MD reads");
 			setup_md(retron);
 			puts("dumping cartridge");
+			telemetry_dump();
 			read_range_swapped(retron, buffer, 0, sizeof(buffer));
-			write(outfd, buffer, sizeof(buffer));
-			uint32_t length = (buffer[0x1a4] << 24 | buffer[0x1a5] << 16 | buffer[0x1a6] << 8 | buffer[0x1a7]) + 1;
-			if (length == 4*1024*1024  && !memcmp(buffer+0x120, SSF2, strlen(SSF2))) {
-				length += 1024*1024;
-			} else if (length > 4*1024*1024 && force_size < 0) {
-				force_size = 4*1024*1024;
-			}
-			if (force_size >= 0) {
-				fprintf(stderr, "Size of %d bytes read from header, forcing %d\n", length, force_size);
-				length = force_size;
-			}
-			printf("Cartridge size is %X\n", length);
-			for (uint32_t address = 0x800; address < length; address+=sizeof(buffer))
-			{
-				printf("\r%d%%", 100 * address / length);
-				fflush(stdout);
-				uint32_t size = sizeof(buffer) < length-address ? sizeof(buffer) : length-address;
-				read_range_swapped(retron, buffer, address, size);
-				write(outfd, buffer, sizeof(buffer));
+			dump_plan plan;
+			plan_dump(buffer, force_size, &plan);
+			printf("Cartridge size is %X\n", plan.rom_size);
+			dump_rom(retron, outfd, &plan);
+			if (plan.sram_size) {
+				char *sram_name = malloc(strlen(fname) + strlen(SRAM_SUFFIX) + 1);
+				sprintf(sram_name, "%s%s", fname, SRAM_SUFFIX);
+				int sramfd = open(sram_name, O_WRONLY | O_TRUNC | O_CREAT, 0664);
+				if (sramfd < 0) {
+					fprintf(stderr, "Failed to open %s for writing\n", sram_name);
+				} else {
+					printf("\nDumping %X bytes of SRAM to %s\n", plan.sram_size, sram_name);
+					dump_sram(retron, sramfd, &plan);
+					close(sramfd);
+				}
+				free(sram_name);
 			}
+			telemetry_done();
 			puts("\nDONE");
 		} else if (do_led) {
 			set_leds(retron, strtol(argv[2], NULL, 16));
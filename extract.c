@@ -7,49 +7,115 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "md5.h"
+#include "sha1.h"
+#include "firmware.h"
 
-#define DIR_SIZE 0xE4
-#define HEADER_SIZE 0x66
-
-#define ENTRY_SIZE 0x39
 uint8_t header[DIR_SIZE+HEADER_SIZE];
 uint8_t buffer[0x800];
+uint64_t bytes_copied;
+
+#define VERIFY_NONE 0
+#define VERIFY_FAILED 1
+#define VERIFY_RUNNING 2
+#define VERIFY_DONE 3
+
+#define CHECKSUM_SIZE 64
 
+//Image is mapped once and shared between the extraction code and the verifier thread
+uint8_t *image_map;
+uint32_t image_size;
+int verify_state;
+pthread_t verify_thread;
+char *checksum_name;
+char expected_sum[CHECKSUM_SIZE+1];
+char actual_sum[CHECKSUM_SIZE+1];
+char verify_error[256];
+char *verify_note = "no checksum was found";
+//set while copying sections that are covered by an Android boot image id
+sha1_context *copy_hash;
 
-#define TOP_MAGIC "RKFW"
-#define TOP_MAGIC_SIZE (sizeof(TOP_MAGIC)-1)
-#define BOOT_MAGIC "BOOT"
-#define BOOT_MAGIC_SIZE (sizeof(BOOT_MAGIC)-1)
-#define SYSTEM_MAGIC "RKAF"
-#define SYSTEM_MAGIC_SIZE (sizeof(SYSTEM_MAGIC)-1)
-#define ANDROID_MAGIC "ANDROID!"
-#define ANDROID_MAGIC_SIZE (sizeof(ANDROID_MAGIC)-1)
-
-#define BOOT_OFF 0x19
-#define SYSTEM_OFF 0x21
-#define BOOT_FNAME_OFF 5
-#define BOOT_FNAME_SIZE 0x28
-#define BOOT_OFF_OFF (BOOT_FNAME_OFF+BOOT_FNAME_SIZE)
-#define BOOT_SIZE_OFF (BOOT_OFF_OFF+4)
-#define SYSTEM_DIR_OFF 0x88
-#define SYSTEM_NAME_SIZE 0x20
-#define SYSTEM_PATH_SIZE 0x3C
-#define SYSTEM_OFF_OFF (SYSTEM_NAME_SIZE+SYSTEM_PATH_SIZE+sizeof(uint32_t))
-#define SYSTEM_SIZE_OFF (SYSTEM_NAME_SIZE+SYSTEM_PATH_SIZE+4*sizeof(uint32_t))
-#define SYSTEM_ENTRY_SIZE (SYSTEM_NAME_SIZE+SYSTEM_PATH_SIZE+5*sizeof(uint32_t))
+int finish_verify(void);
+
+#define ZIP_MAGIC "PK\x03\x04"
+#define ZIP_MAGIC_SIZE (sizeof(ZIP_MAGIC)-1)
+#define ELF_MAGIC "\x7F" "ELF"
+#define ELF_MAGIC_SIZE (sizeof(ELF_MAGIC)-1)
 
 #define BOOT_FILE_PREFIX "boot/"
 #define SYSTEM_FILE_PREFIX "system/"
 
-#define KERN_SIZE_OFF 0x8
-#define RDISK_SIZE_OFF 0x10
-#define PAGE_SIZE_OFF 0x24
+#define ZIP_EOCD_SIG 0x06054B50
+#define ZIP_EOCD_SIZE 0x16
+#define ZIP_MAX_COMMENT 0xFFFF
+#define ZIP_EOCD_COUNT_OFF 0xA
+#define ZIP_EOCD_DIR_SIZE_OFF 0xC
+#define ZIP_EOCD_DIR_OFF_OFF 0x10
+#define ZIP_DIR_SIG 0x02014B50
+#define ZIP_DIR_ENTRY_SIZE 0x2E
+#define ZIP_DIR_METHOD_OFF 0xA
+#define ZIP_DIR_CRC_OFF 0x10
+#define ZIP_DIR_CSIZE_OFF 0x14
+#define ZIP_DIR_USIZE_OFF 0x18
+#define ZIP_DIR_NAME_LEN_OFF 0x1C
+#define ZIP_DIR_EXTRA_LEN_OFF 0x1E
+#define ZIP_DIR_COMMENT_LEN_OFF 0x20
+#define ZIP_DIR_LOCAL_OFF_OFF 0x2A
+#define ZIP_LOCAL_SIG 0x04034B50
+#define ZIP_LOCAL_SIZE 0x1E
+#define ZIP_LOCAL_NAME_LEN_OFF 0x1A
+#define ZIP_LOCAL_EXTRA_LEN_OFF 0x1C
+#define ZIP_METHOD_STORE 0
+#define ZIP_METHOD_DEFLATE 8
+
+#define LIBRETRON_NAME "libretron.so"
+#define FPGA_FNAME "retron.fpga"
+#define KNOWN_FPGA_MD5 "06f705e45fe5c41d241d29ecc6c18530"
+
+#define XILINX_SYNC 0xAA995566
+#define XILINX_DUMMY 0xFF
+#define XILINX_TYPE1 1
+#define XILINX_TYPE2 2
+#define XILINX_OP_WRITE 2
+#define XILINX_CMD_DESYNC 0xD
+//Spartan-3A/Spartan-6 use 16-bit packets, Spartan-3 and Virtex-II use 32-bit ones
+#define XILINX_CMD_REG16 0x5
+#define XILINX_NOOP16 0x2000
+#define XILINX_CMD_REG32 0x4
+#define XILINX_NOOP32 0x20000000
+//.bit files prefix the raw bitstream with a header of design info fields
+//the last field, 'e', is the big endian length of the raw bitstream
+#define BIT_HEADER_MAGIC "\x00\x09\x0F\xF0\x0F\xF0\x0F\xF0\x0F\xF0\x00\x00\x01"
+#define BIT_HEADER_MAGIC_SIZE (sizeof(BIT_HEADER_MAGIC)-1)
+#define BIT_HEADER_MAX 0x200
+#define BIT_FIELD_DATA 'e'
 
 uint32_t getu32le(uint8_t *off)
 {
 	return off[0] | off[1] << 8 | off[2] << 16 | off[3] << 24;
 }
 
+uint16_t getu16le(uint8_t *off)
+{
+	return off[0] | off[1] << 8;
+}
+
+uint32_t getu32be(uint8_t *off)
+{
+	return off[0] << 24 | off[1] << 16 | off[2] << 8 | off[3];
+}
+
+uint16_t getu16be(uint8_t *off)
+{
+	return off[0] << 8 | off[1];
+}
+
 void checked_read(FILE *f, uint8_t *buffer, uint32_t size, char *fname)
 {
 	if (size != fread(buffer, 1, size, f)) {
@@ -98,21 +164,124 @@ char * alloc_concat(char * first, char * second)
 
 void copy_data(FILE *imf, char *ifname, uint32_t offset, FILE *outf, uint32_t fsize)
 {
+	if (image_map) {
+		if (offset > image_size || fsize > image_size - offset) {
+			fprintf(stderr, "%s is truncated, expected at least %u bytes, but it is only %u bytes\n", ifname, offset + fsize, image_size);
+			finish_verify();
+			exit(1);
+		}
+		if (copy_hash) {
+			sha1_update(copy_hash, image_map + offset, fsize);
+		}
+		if (outf) {
+			fwrite(image_map + offset, 1, fsize, outf);
+			bytes_copied += fsize;
+		}
+		return;
+	}
 	fseek(imf, offset, SEEK_SET);
 	while (fsize) {
 		uint32_t chunk_size = fsize < sizeof(buffer) ? fsize : sizeof(buffer);
 		checked_read(imf, buffer, chunk_size, ifname);
-		fwrite(buffer, 1, chunk_size, outf);
+		if (copy_hash) {
+			sha1_update(copy_hash, buffer, chunk_size);
+		}
+		if (outf) {
+			fwrite(buffer, 1, chunk_size, outf);
+			bytes_copied += chunk_size;
+		}
 		fsize -= chunk_size;
 	}
 }
 
+void *verify_rkfw(void *unused)
+{
+	md5_context md5;
+	uint8_t digest[MD5_DIGEST_SIZE];
+	md5_init(&md5);
+	md5_update(&md5, image_map, image_size - RKFW_MD5_SIZE);
+	md5_final(&md5, digest);
+	md5_to_hex(digest, actual_sum);
+	return NULL;
+}
+
+void verify_failed(char *reason)
+{
+	strncpy(verify_error, reason, sizeof(verify_error)-1);
+	fprintf(stderr, "Warning: %s\n", verify_error);
+	verify_state = VERIFY_FAILED;
+}
+
+//expected_end is where the header says the image data stops, the md5 follows it
+void start_verify(FILE *imf, char *fname, uint64_t expected_end)
+{
+	struct stat st;
+	if (fstat(fileno(imf), &st) || st.st_size > UINT32_MAX) {
+		fprintf(stderr, "Failed to get size of %s\n", fname);
+		exit(1);
+	}
+	image_size = st.st_size;
+	image_map = mmap(NULL, image_size, PROT_READ, MAP_SHARED, fileno(imf), 0);
+	if (image_map == MAP_FAILED) {
+		fprintf(stderr, "Failed to map %s\n", fname);
+		exit(1);
+	}
+	checksum_name = "md5";
+	if (image_size != expected_end + RKFW_MD5_SIZE) {
+		char reason[sizeof(verify_error)];
+		snprintf(reason, sizeof(reason), "%s is %u bytes, but its header expects %llu bytes including the md5",
+			fname, image_size, (unsigned long long)(expected_end + RKFW_MD5_SIZE));
+		verify_failed(reason);
+		return;
+	}
+	memcpy(expected_sum, image_map + image_size - RKFW_MD5_SIZE, RKFW_MD5_SIZE);
+	expected_sum[RKFW_MD5_SIZE] = 0;
+	if (strspn(expected_sum, "0123456789abcdef") != RKFW_MD5_SIZE) {
+		verify_failed("md5 at the end of the image is missing or malformed");
+		return;
+	}
+	if (pthread_create(&verify_thread, NULL, verify_rkfw, NULL)) {
+		fputs("Failed to start verification thread\n", stderr);
+		exit(1);
+	}
+	verify_state = VERIFY_RUNNING;
+}
+
+//returns 1 if verification failed, 0 otherwise
+int finish_verify(void)
+{
+	int failed = 0;
+	if (verify_state == VERIFY_RUNNING) {
+		pthread_join(verify_thread, NULL);
+		verify_state = VERIFY_DONE;
+	}
+	if (verify_state == VERIFY_DONE) {
+		if (strcmp(expected_sum, actual_sum)) {
+			printf("\nImage checksum: FAIL, expected %s %s, but got %s\n", checksum_name, expected_sum, actual_sum);
+			failed = 1;
+		} else {
+			printf("\nImage checksum: PASS, %s %s\n", checksum_name, actual_sum);
+		}
+	} else if (verify_state == VERIFY_FAILED) {
+		printf("\nImage checksum: FAIL, %s\n", verify_error);
+		failed = 1;
+	} else {
+		printf("\nImage checksum: not verified, %s\n", verify_note);
+	}
+	if (image_map) {
+		munmap(image_map, image_size);
+		image_map = NULL;
+	}
+	return failed;
+}
+
 void extract_rkfw(FILE *imf, char *fname)
 {
 	uint32_t boot_start = getu32le(header+BOOT_OFF);
 	uint32_t boot_size = getu32le(header+BOOT_OFF+sizeof(uint32_t));
 	uint32_t system_start = getu32le(header+SYSTEM_OFF);
 	uint32_t system_size = getu32le(header+SYSTEM_OFF+sizeof(uint32_t));
+	start_verify(imf, fname, (uint64_t)system_start + system_size);
 	
 	printf("Boot image offset: %X, size: %u\n", boot_start, boot_size);
 	printf("System image offset: %X, size: %u\n", system_start, system_size);
@@ -126,12 +295,12 @@ void extract_rkfw(FILE *imf, char *fname)
 		puts( "----------------------------------------");
 		for (uint32_t cur = HEADER_SIZE; cur < HEADER_SIZE+DIR_SIZE; cur += ENTRY_SIZE)
 		{
-			char *fname = copy_fixed(header + cur + BOOT_FNAME_OFF, BOOT_FNAME_SIZE, 2);
+			char *entry_name = copy_fixed(header + cur + BOOT_FNAME_OFF, BOOT_FNAME_SIZE, 2);
 			uint32_t foff = getu32le(header + cur + BOOT_OFF_OFF);
 			uint32_t fsize = getu32le(header + cur + BOOT_SIZE_OFF);
-			printf("%-20s %-11u %-8X\n", fname, fsize, foff);
-			char *path = alloc_concat(BOOT_FILE_PREFIX, fname);
-			free(fname);
+			printf("%-20s %-11u %-8X\n", entry_name, fsize, foff);
+			char *path = alloc_concat(BOOT_FILE_PREFIX, entry_name);
+			free(entry_name);
 			//TODO: Make directories if necessary
 			FILE *outf = fopen(path, "wb");
 			if (!outf) {
@@ -177,12 +346,32 @@ void extract_rkfw(FILE *imf, char *fname)
 	free(dir);
 }
 
+void hash_u32le(sha1_context *ctx, uint32_t val)
+{
+	uint8_t bytes[] = {val, val >> 8, val >> 16, val >> 24};
+	sha1_update(ctx, bytes, sizeof(bytes));
+}
+
 void extract_android(FILE *imf, char *fname)
 {
 	uint32_t kern_size = getu32le(header + KERN_SIZE_OFF);
 	uint32_t rdisk_size = getu32le(header + RDISK_SIZE_OFF);
+	uint32_t second_size = getu32le(header + SECOND_SIZE_OFF);
 	uint32_t page_size = getu32le(header + PAGE_SIZE_OFF);
 	
+	uint8_t id[ANDROID_ID_SIZE];
+	fseek(imf, ANDROID_ID_OFF, SEEK_SET);
+	checked_read(imf, id, sizeof(id), fname);
+	sha1_context sha1;
+	for (uint32_t i = 0; i < sizeof(id); i++)
+	{
+		if (id[i]) {
+			sha1_init(&sha1);
+			copy_hash = &sha1;
+			break;
+		}
+	}
+	
 	FILE *outf = fopen("kernel", "wb");
 	if (!outf) {
 		fputs("Failed to open kernel for writing\n", stderr);
@@ -196,16 +385,361 @@ void extract_android(FILE *imf, char *fname)
 		fputs("Failed to open ramdisk.gz for writing\n", stderr);
 		exit(1);
 	}
+	if (copy_hash) {
+		hash_u32le(copy_hash, kern_size);
+	}
 	copy_data(imf, fname, rdisk_off, outf, rdisk_size);
 	fclose(outf);
+	if (!copy_hash) {
+		verify_note = "boot image id is empty";
+		return;
+	}
+	hash_u32le(copy_hash, rdisk_size);
+	//the second stage isn't extracted, but it is covered by the id
+	uint32_t second_off = rdisk_off + (rdisk_size + page_size - 1)/page_size * page_size;
+	copy_data(imf, fname, second_off, NULL, second_size);
+	hash_u32le(copy_hash, second_size);
+	copy_hash = NULL;
+	
+	uint8_t digest[SHA1_DIGEST_SIZE];
+	sha1_final(&sha1, digest);
+	sha1_to_hex(id, expected_sum);
+	sha1_to_hex(digest, actual_sum);
+	checksum_name = "sha1";
+	verify_state = VERIFY_DONE;
+}
+
+uint32_t skip_noops(uint8_t *data, uint32_t pos, uint32_t size, uint32_t word_size)
+{
+	while (pos + word_size <= size)
+	{
+		if (word_size == 2 ? getu16be(data + pos) != XILINX_NOOP16 : getu32be(data + pos) != XILINX_NOOP32) {
+			break;
+		}
+		pos += word_size;
+	}
+	return pos;
+}
+
+//Walks 16-bit configuration packets starting just past the sync word
+//returns the offset just past the trailing NOOPs after DESYNC or 0 if the framing is invalid
+uint32_t parse_packets16(uint8_t *data, uint32_t pos, uint32_t size)
+{
+	while (pos + 2 <= size)
+	{
+		uint16_t hdr = getu16be(data + pos);
+		pos += 2;
+		uint32_t count;
+		if (hdr >> 13 == XILINX_TYPE1) {
+			count = hdr & 0x1F;
+			if (count > (size - pos) / 2) {
+				return 0;
+			}
+			if ((hdr >> 11 & 3) == XILINX_OP_WRITE && (hdr >> 5 & 0x3F) == XILINX_CMD_REG16
+				&& count == 1 && getu16be(data + pos) == XILINX_CMD_DESYNC
+			) {
+				return skip_noops(data, pos + 2, size, 2);
+			}
+		} else if (hdr >> 13 == XILINX_TYPE2) {
+			if (size - pos < 4) {
+				return 0;
+			}
+			count = getu16be(data + pos) << 16 | getu16be(data + pos + 2);
+			pos += 4;
+			if (count > (size - pos) / 2) {
+				return 0;
+			}
+		} else {
+			return 0;
+		}
+		pos += count * 2;
+	}
+	return 0;
+}
+
+//Same as parse_packets16, but for the 32-bit packet format
+uint32_t parse_packets32(uint8_t *data, uint32_t pos, uint32_t size)
+{
+	while (pos + 4 <= size)
+	{
+		uint32_t hdr = getu32be(data + pos);
+		pos += 4;
+		uint32_t count;
+		if (hdr >> 29 == XILINX_TYPE1) {
+			count = hdr & 0x7FF;
+			if (count > (size - pos) / 4) {
+				return 0;
+			}
+			if ((hdr >> 27 & 3) == XILINX_OP_WRITE && (hdr >> 13 & 0x3FFF) == XILINX_CMD_REG32
+				&& count == 1 && getu32be(data + pos) == XILINX_CMD_DESYNC
+			) {
+				return skip_noops(data, pos + 4, size, 4);
+			}
+		} else if (hdr >> 29 == XILINX_TYPE2) {
+			count = hdr & 0x7FFFFFF;
+			if (count > (size - pos) / 4) {
+				return 0;
+			}
+		} else {
+			return 0;
+		}
+		pos += count * 4;
+	}
+	return 0;
+}
+
+//Looks for a .bit header ending right before the raw bitstream at start
+//returns the offset of the header or start if there isn't one
+uint32_t find_bit_header(uint8_t *data, uint32_t start, uint32_t *raw_size)
+{
+	uint32_t min = start > BIT_HEADER_MAX ? start - BIT_HEADER_MAX : 0;
+	for (uint32_t hdr = start; hdr-- > min;)
+	{
+		if (start - hdr < BIT_HEADER_MAGIC_SIZE + 5 || memcmp(data + hdr, BIT_HEADER_MAGIC, BIT_HEADER_MAGIC_SIZE)) {
+			continue;
+		}
+		uint32_t pos = hdr + BIT_HEADER_MAGIC_SIZE;
+		//string fields 'a' through 'd' have a 16-bit length
+		while (pos + 3 <= start && data[pos] != BIT_FIELD_DATA)
+		{
+			pos += 3 + getu16be(data + pos + 1);
+		}
+		if (pos + 5 == start && data[pos] == BIT_FIELD_DATA) {
+			*raw_size = getu32be(data + pos + 1);
+			return hdr;
+		}
+	}
+	return start;
+}
+
+//Scans for a Xilinx sync word followed by valid packet framing
+//memchr is used to skip ahead to candidate bytes since it is vectorized in any reasonable libc
+int find_bitstream(uint8_t *data, uint32_t size, uint32_t *start_out, uint32_t *size_out)
+{
+	uint8_t *cur = data;
+	uint8_t *end = data + size;
+	while (end - cur >= 4 && (cur = memchr(cur, XILINX_SYNC >> 24, end - cur - 3)))
+	{
+		if (getu32be(cur) == XILINX_SYNC) {
+			uint32_t pos = cur - data + 4;
+			uint32_t stop = parse_packets16(data, pos, size);
+			if (!stop) {
+				stop = parse_packets32(data, pos, size);
+			}
+			if (stop) {
+				uint32_t start = cur - data;
+				while (start && data[start-1] == XILINX_DUMMY)
+				{
+					start--;
+				}
+				uint32_t raw_size = 0;
+				uint32_t hdr = find_bit_header(data, start, &raw_size);
+				//trust the .bit length for any padding after the trailing NOOPs
+				if (raw_size >= stop - start && raw_size <= size - start) {
+					stop = start + raw_size;
+				}
+				*start_out = hdr;
+				*size_out = stop - hdr;
+				return 1;
+			}
+		}
+		cur++;
+	}
+	return 0;
+}
+
+void extract_fpga(uint8_t *lib, uint32_t lib_size)
+{
+	uint32_t start, size;
+	if (!find_bitstream(lib, lib_size, &start, &size)) {
+		fputs("Failed to find FPGA bitstream in " LIBRETRON_NAME "\n", stderr);
+		exit(1);
+	}
+	md5_context md5;
+	uint8_t digest[MD5_DIGEST_SIZE];
+	char hex[MD5_DIGEST_SIZE*2+1];
+	md5_init(&md5);
+	md5_update(&md5, lib + start, size);
+	md5_final(&md5, digest);
+	md5_to_hex(digest, hex);
+	printf("FPGA bitstream offset: %X, size: %u, md5: %s\n", start, size, hex);
+	
+	FILE *outf = fopen(FPGA_FNAME, "wb");
+	if (!outf) {
+		fputs("Failed to open " FPGA_FNAME " for writing\n", stderr);
+		exit(1);
+	}
+	if (size != fwrite(lib + start, 1, size, outf)) {
+		fputs("Failed to write to " FPGA_FNAME "\n", stderr);
+		exit(1);
+	}
+	fclose(outf);
+	bytes_copied += size;
+	if (strcmp(hex, KNOWN_FPGA_MD5)) {
+		fputs("Warning: md5 does not match known bitstream " KNOWN_FPGA_MD5 "\n", stderr);
+	}
+}
+
+void extract_elf(FILE *imf, char *fname)
+{
+	verify_note = "bare libretron.so files carry no checksum";
+	fseek(imf, 0, SEEK_END);
+	uint32_t lib_size = ftell(imf);
+	fseek(imf, 0, SEEK_SET);
+	uint8_t *lib = malloc(lib_size);
+	checked_read(imf, lib, lib_size, fname);
+	extract_fpga(lib, lib_size);
+	free(lib);
+}
+
+//Decompresses a zip member into dst while reading it in buffer-sized chunks
+void inflate_data(FILE *imf, char *fname, uint32_t csize, uint8_t *dst, uint32_t usize)
+{
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	if (Z_OK != inflateInit2(&strm, -MAX_WBITS)) {
+		fputs("Failed to initialize zlib\n", stderr);
+		exit(1);
+	}
+	strm.next_out = dst;
+	strm.avail_out = usize;
+	int status = Z_OK;
+	while (status == Z_OK && csize)
+	{
+		uint32_t chunk_size = csize < sizeof(buffer) ? csize : sizeof(buffer);
+		checked_read(imf, buffer, chunk_size, fname);
+		csize -= chunk_size;
+		strm.next_in = buffer;
+		strm.avail_in = chunk_size;
+		status = inflate(&strm, Z_NO_FLUSH);
+	}
+	inflateEnd(&strm);
+	if (status != Z_STREAM_END || strm.total_out != usize) {
+		fprintf(stderr, "Failed to decompress " LIBRETRON_NAME " from %s\n", fname);
+		exit(1);
+	}
+}
+
+void extract_apk(FILE *imf, char *fname)
+{
+	fseek(imf, 0, SEEK_END);
+	uint32_t file_size = ftell(imf);
+	uint32_t tail_size = file_size < ZIP_EOCD_SIZE + ZIP_MAX_COMMENT ? file_size : ZIP_EOCD_SIZE + ZIP_MAX_COMMENT;
+	uint8_t *tail = malloc(tail_size);
+	fseek(imf, file_size - tail_size, SEEK_SET);
+	checked_read(imf, tail, tail_size, fname);
+	uint8_t *eocd = NULL;
+	for (uint32_t cur = tail_size - ZIP_EOCD_SIZE + 1; cur-- > 0;)
+	{
+		if (getu32le(tail + cur) == ZIP_EOCD_SIG) {
+			eocd = tail + cur;
+			break;
+		}
+	}
+	if (!eocd) {
+		fprintf(stderr, "Failed to find zip directory in %s\n", fname);
+		exit(1);
+	}
+	uint32_t count = getu16le(eocd + ZIP_EOCD_COUNT_OFF);
+	uint32_t dir_size = getu32le(eocd + ZIP_EOCD_DIR_SIZE_OFF);
+	uint32_t dir_off = getu32le(eocd + ZIP_EOCD_DIR_OFF_OFF);
+	free(tail);
+	
+	uint8_t *dir = malloc(dir_size);
+	fseek(imf, dir_off, SEEK_SET);
+	checked_read(imf, dir, dir_size, fname);
+	uint32_t cur = 0;
+	uint32_t name_size = strlen(LIBRETRON_NAME);
+	for (; count; count--)
+	{
+		if (dir_size - cur < ZIP_DIR_ENTRY_SIZE || getu32le(dir + cur) != ZIP_DIR_SIG) {
+			fprintf(stderr, "Corrupt zip directory in %s\n", fname);
+			exit(1);
+		}
+		uint32_t name_len = getu16le(dir + cur + ZIP_DIR_NAME_LEN_OFF);
+		uint32_t entry_size = ZIP_DIR_ENTRY_SIZE + name_len + getu16le(dir + cur + ZIP_DIR_EXTRA_LEN_OFF)
+			+ getu16le(dir + cur + ZIP_DIR_COMMENT_LEN_OFF);
+		if (entry_size > dir_size - cur) {
+			fprintf(stderr, "Corrupt zip directory in %s\n", fname);
+			exit(1);
+		}
+		uint8_t *name = dir + cur + ZIP_DIR_ENTRY_SIZE;
+		if (
+			name_len >= name_size && !memcmp(name + name_len - name_size, LIBRETRON_NAME, name_size)
+			&& (name_len == name_size || name[name_len - name_size - 1] == '/')
+		) {
+			break;
+		}
+		cur += entry_size;
+	}
+	if (!count) {
+		fprintf(stderr, "Failed to find " LIBRETRON_NAME " in %s\n", fname);
+		exit(1);
+	}
+	uint32_t method = getu16le(dir + cur + ZIP_DIR_METHOD_OFF);
+	uint32_t csize = getu32le(dir + cur + ZIP_DIR_CSIZE_OFF);
+	uint32_t usize = getu32le(dir + cur + ZIP_DIR_USIZE_OFF);
+	uint32_t local_off = getu32le(dir + cur + ZIP_DIR_LOCAL_OFF_OFF);
+	uint32_t crc = getu32le(dir + cur + ZIP_DIR_CRC_OFF);
+	printf("%.*s offset: %X, size: %u, compressed size: %u\n", 
+		(int)getu16le(dir + cur + ZIP_DIR_NAME_LEN_OFF), dir + cur + ZIP_DIR_ENTRY_SIZE, local_off, usize, csize);
+	free(dir);
+	
+	fseek(imf, local_off, SEEK_SET);
+	checked_read(imf, header, ZIP_LOCAL_SIZE, fname);
+	if (getu32le(header) != ZIP_LOCAL_SIG) {
+		fprintf(stderr, "Corrupt zip entry for " LIBRETRON_NAME " in %s\n", fname);
+		exit(1);
+	}
+	fseek(imf, getu16le(header + ZIP_LOCAL_NAME_LEN_OFF) + getu16le(header + ZIP_LOCAL_EXTRA_LEN_OFF), SEEK_CUR);
+	uint8_t *lib = malloc(usize);
+	if (method == ZIP_METHOD_STORE) {
+		checked_read(imf, lib, usize, fname);
+	} else if (method == ZIP_METHOD_DEFLATE) {
+		inflate_data(imf, fname, csize, lib, usize);
+	} else {
+		fprintf(stderr, "Unsupported compression method %u for " LIBRETRON_NAME "\n", method);
+		exit(1);
+	}
+	checksum_name = "crc32";
+	snprintf(expected_sum, sizeof(expected_sum), "%08x", crc);
+	snprintf(actual_sum, sizeof(actual_sum), "%08lx", crc32(0, lib, usize));
+	verify_state = VERIFY_DONE;
+	extract_fpga(lib, usize);
+	free(lib);
+}
+
+double elapsed(struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void print_stats(struct timespec *start)
+{
+	double seconds = elapsed(start);
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	printf("\nBytes extracted: %llu\n", (unsigned long long)bytes_copied);
+	printf("Elapsed: %.3fs, throughput: %.1f MB/s\n", seconds, seconds > 0 ? bytes_copied / seconds / (1024*1024) : 0.0);
+	printf("Peak RSS: %ld KB, blocks in: %ld, blocks out: %ld\n", usage.ru_maxrss, usage.ru_inblock, usage.ru_oublock);
 }
 
 int main(int argc, char ** argv)
 {
+	int stats = 0;
+	if (argc > 1 && !strcmp(argv[1], "-s")) {
+		stats = 1;
+		argv++;
+		argc--;
+	}
 	if (argc < 2) {
-		fputs("usage: extract IMAGE\n", stderr);
+		fputs("usage: extract [-s] IMAGE|APK|libretron.so\n", stderr);
 		exit(1);
 	}
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
 	FILE *imf = fopen(argv[1], "rb");
 	if (!imf) {
 		fprintf(stderr, "Failed to open %s\n", argv[1]);
@@ -216,11 +750,19 @@ int main(int argc, char ** argv)
 		extract_rkfw(imf, argv[1]);
 	} else if(!memcmp(header, ANDROID_MAGIC, ANDROID_MAGIC_SIZE)) {
 		extract_android(imf, argv[1]);
+	} else if(!memcmp(header, ZIP_MAGIC, ZIP_MAGIC_SIZE)) {
+		extract_apk(imf, argv[1]);
+	} else if(!memcmp(header, ELF_MAGIC, ELF_MAGIC_SIZE)) {
+		extract_elf(imf, argv[1]);
 	} else {
 		fprintf(stderr, "Unrecognized magic %.*s\n", (int)TOP_MAGIC_SIZE, header);
 		exit(1);
 	}
+	int failed = finish_verify();
+	if (stats) {
+		print_stats(&start);
+	}
 	
 
-	return 0;
+	return failed;
 }
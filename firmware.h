@@ -0,0 +1,51 @@
+/*
+ Copyright 2018 Michael Pavone
+ This file is part of retron_dump.
+ retron_dump is free software distributed under the terms of the GNU General Public License version 3 or greater. See LICENSE for full license text.
+*/
+#ifndef FIRMWARE_H_
+#define FIRMWARE_H_
+
+//Layout of Rockchip RKFW update images and Android boot images
+//shared between extract and fwgen
+
+#define DIR_SIZE 0xE4
+#define HEADER_SIZE 0x66
+
+#define ENTRY_SIZE 0x39
+
+#define TOP_MAGIC "RKFW"
+#define TOP_MAGIC_SIZE (sizeof(TOP_MAGIC)-1)
+#define BOOT_MAGIC "BOOT"
+#define BOOT_MAGIC_SIZE (sizeof(BOOT_MAGIC)-1)
+#define SYSTEM_MAGIC "RKAF"
+#define SYSTEM_MAGIC_SIZE (sizeof(SYSTEM_MAGIC)-1)
+#define ANDROID_MAGIC "ANDROID!"
+#define ANDROID_MAGIC_SIZE (sizeof(ANDROID_MAGIC)-1)
+
+#define BOOT_OFF 0x19
+#define SYSTEM_OFF 0x21
+#define BOOT_FNAME_OFF 5
+#define BOOT_FNAME_SIZE 0x28
+#define BOOT_OFF_OFF (BOOT_FNAME_OFF+BOOT_FNAME_SIZE)
+#define BOOT_SIZE_OFF (BOOT_OFF_OFF+4)
+#define BOOT_ENTRIES (DIR_SIZE/ENTRY_SIZE)
+#define SYSTEM_DIR_OFF 0x88
+#define SYSTEM_NAME_SIZE 0x20
+#define SYSTEM_PATH_SIZE 0x3C
+#define SYSTEM_OFF_OFF (SYSTEM_NAME_SIZE+SYSTEM_PATH_SIZE+sizeof(uint32_t))
+#define SYSTEM_SIZE_OFF (SYSTEM_NAME_SIZE+SYSTEM_PATH_SIZE+4*sizeof(uint32_t))
+#define SYSTEM_ENTRY_SIZE (SYSTEM_NAME_SIZE+SYSTEM_PATH_SIZE+5*sizeof(uint32_t))
+
+//RKFW images end with the md5 of everything before it as lowercase hex
+#define RKFW_MD5_SIZE 32
+
+#define KERN_SIZE_OFF 0x8
+#define RDISK_SIZE_OFF 0x10
+#define SECOND_SIZE_OFF 0x18
+#define PAGE_SIZE_OFF 0x24
+//mkbootimg stores the sha1 of each section and its size here, padded to 32 bytes
+#define ANDROID_ID_OFF 0x240
+#define ANDROID_ID_SIZE 32
+
+#endif //FIRMWARE_H_
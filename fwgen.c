@@ -0,0 +1,228 @@
+/*
+ Copyright 2018 Michael Pavone
+ This file is part of retron_dump.
+ retron_dump is free software distributed under the terms of the GNU General Public License version 3 or greater. See LICENSE for full license text.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "md5.h"
+#include "sha1.h"
+#include "firmware.h"
+
+//Generates synthetic RKFW and Android boot images for exercising extract
+//without a real vendor image
+
+#define BOOT_START 0x800
+#define SYSTEM_ALIGN 0x800
+#define ANDROID_PAGE_SIZE 0x800
+
+uint8_t header[SYSTEM_DIR_OFF+sizeof(uint32_t)];
+uint8_t buffer[0x10000];
+
+FILE *outf;
+char *out_name;
+uint32_t out_pos;
+md5_context md5;
+sha1_context *payload_hash;
+uint32_t rng_state = 0x2F6B7A3D;
+
+void putu32le(uint8_t *off, uint32_t val)
+{
+	off[0] = val;
+	off[1] = val >> 8;
+	off[2] = val >> 16;
+	off[3] = val >> 24;
+}
+
+void checked_write(uint8_t *data, uint32_t size)
+{
+	if (size != fwrite(data, 1, size, outf)) {
+		fprintf(stderr, "Failed to write to %s\n", out_name);
+		exit(1);
+	}
+	md5_update(&md5, data, size);
+	out_pos += size;
+}
+
+void pad_to(uint32_t offset)
+{
+	memset(buffer, 0, sizeof(buffer));
+	while (out_pos < offset)
+	{
+		uint32_t chunk_size = offset - out_pos < sizeof(buffer) ? offset - out_pos : sizeof(buffer);
+		checked_write(buffer, chunk_size);
+	}
+}
+
+//fills with xorshift output so the payload doesn't compress or dedupe
+void write_payload(uint32_t size)
+{
+	while (size)
+	{
+		uint32_t chunk_size = size < sizeof(buffer) ? size : sizeof(buffer);
+		for (uint32_t i = 0; i < chunk_size; i += sizeof(uint32_t))
+		{
+			rng_state ^= rng_state << 13;
+			rng_state ^= rng_state >> 17;
+			rng_state ^= rng_state << 5;
+			putu32le(buffer + i, rng_state);
+		}
+		if (payload_hash) {
+			sha1_update(payload_hash, buffer, chunk_size);
+		}
+		checked_write(buffer, chunk_size);
+		size -= chunk_size;
+	}
+}
+
+uint32_t align(uint32_t val, uint32_t alignment)
+{
+	return (val + alignment - 1) / alignment * alignment;
+}
+
+uint32_t parse_size(char *str)
+{
+	char *end;
+	uint32_t size = strtoul(str, &end, 0);
+	if (*end == 'K' || *end == 'k') {
+		size *= 1024;
+	} else if (*end == 'M' || *end == 'm') {
+		size *= 1024 * 1024;
+	}
+	return size;
+}
+
+void gen_rkfw(uint32_t size, uint32_t entries)
+{
+	uint32_t boot_data = size / 16 / BOOT_ENTRIES;
+	uint32_t boot_size = HEADER_SIZE + DIR_SIZE + boot_data * BOOT_ENTRIES;
+	uint32_t system_start = align(BOOT_START + boot_size, SYSTEM_ALIGN);
+	uint32_t system_dir_size = SYSTEM_DIR_OFF + sizeof(uint32_t) + entries * SYSTEM_ENTRY_SIZE;
+	uint32_t system_data = (size - size / 16) / entries;
+	uint32_t system_size = system_dir_size + system_data * entries;
+	
+	memset(header, 0, sizeof(header));
+	memcpy(header, TOP_MAGIC, TOP_MAGIC_SIZE);
+	putu32le(header + BOOT_OFF, BOOT_START);
+	putu32le(header + BOOT_OFF + sizeof(uint32_t), boot_size);
+	putu32le(header + SYSTEM_OFF, system_start);
+	putu32le(header + SYSTEM_OFF + sizeof(uint32_t), system_size);
+	checked_write(header, HEADER_SIZE);
+	pad_to(BOOT_START);
+	
+	uint8_t boot_header[HEADER_SIZE+DIR_SIZE];
+	memset(boot_header, 0, sizeof(boot_header));
+	memcpy(boot_header, BOOT_MAGIC, BOOT_MAGIC_SIZE);
+	for (uint32_t i = 0; i < BOOT_ENTRIES; i++)
+	{
+		uint8_t *entry = boot_header + HEADER_SIZE + i * ENTRY_SIZE;
+		char name[BOOT_FNAME_SIZE/2];
+		snprintf(name, sizeof(name), "loader%u", i);
+		for (uint32_t c = 0; name[c]; c++)
+		{
+			entry[BOOT_FNAME_OFF + c*2] = name[c];
+		}
+		putu32le(entry + BOOT_OFF_OFF, HEADER_SIZE + DIR_SIZE + i * boot_data);
+		putu32le(entry + BOOT_SIZE_OFF, boot_data);
+	}
+	checked_write(boot_header, sizeof(boot_header));
+	write_payload(boot_data * BOOT_ENTRIES);
+	pad_to(system_start);
+	
+	memset(header, 0, sizeof(header));
+	memcpy(header, SYSTEM_MAGIC, SYSTEM_MAGIC_SIZE);
+	putu32le(header + SYSTEM_DIR_OFF, entries);
+	checked_write(header, SYSTEM_DIR_OFF + sizeof(uint32_t));
+	for (uint32_t i = 0; i < entries; i++)
+	{
+		uint8_t entry[SYSTEM_ENTRY_SIZE];
+		memset(entry, 0, sizeof(entry));
+		snprintf((char *)entry, SYSTEM_NAME_SIZE, "part%u", i);
+		snprintf((char *)entry + SYSTEM_NAME_SIZE, SYSTEM_PATH_SIZE, "part%u.img", i);
+		putu32le(entry + SYSTEM_OFF_OFF, system_dir_size + i * system_data);
+		putu32le(entry + SYSTEM_SIZE_OFF, system_data);
+		checked_write(entry, sizeof(entry));
+	}
+	write_payload(system_data * entries);
+	
+	uint8_t digest[MD5_DIGEST_SIZE];
+	char hex[RKFW_MD5_SIZE+1];
+	md5_final(&md5, digest);
+	md5_to_hex(digest, hex);
+	checked_write((uint8_t *)hex, RKFW_MD5_SIZE);
+}
+
+void hash_u32le(sha1_context *ctx, uint32_t val)
+{
+	uint8_t bytes[sizeof(uint32_t)];
+	putu32le(bytes, val);
+	sha1_update(ctx, bytes, sizeof(bytes));
+}
+
+void gen_android(uint32_t size)
+{
+	uint32_t kern_size = size / 2;
+	uint32_t rdisk_size = size - kern_size;
+	memset(header, 0, sizeof(header));
+	memcpy(header, ANDROID_MAGIC, ANDROID_MAGIC_SIZE);
+	putu32le(header + KERN_SIZE_OFF, kern_size);
+	putu32le(header + RDISK_SIZE_OFF, rdisk_size);
+	putu32le(header + PAGE_SIZE_OFF, ANDROID_PAGE_SIZE);
+	checked_write(header, HEADER_SIZE);
+	pad_to(ANDROID_PAGE_SIZE);
+	
+	sha1_context sha1;
+	sha1_init(&sha1);
+	payload_hash = &sha1;
+	write_payload(kern_size);
+	hash_u32le(&sha1, kern_size);
+	pad_to(((kern_size + ANDROID_PAGE_SIZE - 1)/ANDROID_PAGE_SIZE + 1) * ANDROID_PAGE_SIZE);
+	write_payload(rdisk_size);
+	hash_u32le(&sha1, rdisk_size);
+	//no second stage
+	hash_u32le(&sha1, 0);
+	payload_hash = NULL;
+	
+	uint8_t id[ANDROID_ID_SIZE];
+	memset(id, 0, sizeof(id));
+	sha1_final(&sha1, id);
+	fseek(outf, ANDROID_ID_OFF, SEEK_SET);
+	if (sizeof(id) != fwrite(id, 1, sizeof(id), outf)) {
+		fprintf(stderr, "Failed to write to %s\n", out_name);
+		exit(1);
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	if (argc < 4) {
+		fputs("usage: fwgen rkfw|android SIZE[K|M] [ENTRIES] OUTFILE\n", stderr);
+		exit(1);
+	}
+	uint32_t size = parse_size(argv[2]) & ~(uint32_t)(sizeof(uint32_t)-1);
+	uint32_t entries = argc > 4 ? strtoul(argv[3], NULL, 0) : 1;
+	if (!entries) {
+		fputs("ENTRIES must be at least 1\n", stderr);
+		exit(1);
+	}
+	out_name = argv[argc-1];
+	outf = fopen(out_name, "wb");
+	if (!outf) {
+		fprintf(stderr, "Failed to open %s for writing\n", out_name);
+		exit(1);
+	}
+	md5_init(&md5);
+	if (!strcmp(argv[1], "rkfw")) {
+		gen_rkfw(size, entries);
+	} else if (!strcmp(argv[1], "android")) {
+		gen_android(size);
+	} else {
+		fprintf(stderr, "Unrecognized image type %s\n", argv[1]);
+		exit(1);
+	}
+	fclose(outf);
+	
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ Copyright 2018 Michael Pavone
+ This file is part of retron_dump.
+ retron_dump is free software distributed under the terms of the GNU General Public License version 3 or greater. See LICENSE for full license text.
+*/
+#include <string.h>
+#include "md5.h"
+
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+#define I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define STEP(f, a, b, c, d, word, sine, shift) \
+	a += f(b, c, d) + word + sine; \
+	a = (a << shift | a >> (32 - shift)) + b;
+
+static void md5_block(md5_context *ctx, const uint8_t *block)
+{
+	uint32_t w[16];
+	for (int i = 0; i < 16; i++)
+	{
+		w[i] = block[i*4] | block[i*4+1] << 8 | block[i*4+2] << 16 | (uint32_t)block[i*4+3] << 24;
+	}
+	uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+	
+	STEP(F, a, b, c, d, w[0], 0xd76aa478, 7)
+	STEP(F, d, a, b, c, w[1], 0xe8c7b756, 12)
+	STEP(F, c, d, a, b, w[2], 0x242070db, 17)
+	STEP(F, b, c, d, a, w[3], 0xc1bdceee, 22)
+	STEP(F, a, b, c, d, w[4], 0xf57c0faf, 7)
+	STEP(F, d, a, b, c, w[5], 0x4787c62a, 12)
+	STEP(F, c, d, a, b, w[6], 0xa8304613, 17)
+	STEP(F, b, c, d, a, w[7], 0xfd469501, 22)
+	STEP(F, a, b, c, d, w[8], 0x698098d8, 7)
+	STEP(F, d, a, b, c, w[9], 0x8b44f7af, 12)
+	STEP(F, c, d, a, b, w[10], 0xffff5bb1, 17)
+	STEP(F, b, c, d, a, w[11], 0x895cd7be, 22)
+	STEP(F, a, b, c, d, w[12], 0x6b901122, 7)
+	STEP(F, d, a, b, c, w[13], 0xfd987193, 12)
+	STEP(F, c, d, a, b, w[14], 0xa679438e, 17)
+	STEP(F, b, c, d, a, w[15], 0x49b40821, 22)
+	
+	STEP(G, a, b, c, d, w[1], 0xf61e2562, 5)
+	STEP(G, d, a, b, c, w[6], 0xc040b340, 9)
+	STEP(G, c, d, a, b, w[11], 0x265e5a51, 14)
+	STEP(G, b, c, d, a, w[0], 0xe9b6c7aa, 20)
+	STEP(G, a, b, c, d, w[5], 0xd62f105d, 5)
+	STEP(G, d, a, b, c, w[10], 0x02441453, 9)
+	STEP(G, c, d, a, b, w[15], 0xd8a1e681, 14)
+	STEP(G, b, c, d, a, w[4], 0xe7d3fbc8, 20)
+	STEP(G, a, b, c, d, w[9], 0x21e1cde6, 5)
+	STEP(G, d, a, b, c, w[14], 0xc33707d6, 9)
+	STEP(G, c, d, a, b, w[3], 0xf4d50d87, 14)
+	STEP(G, b, c, d, a, w[8], 0x455a14ed, 20)
+	STEP(G, a, b, c, d, w[13], 0xa9e3e905, 5)
+	STEP(G, d, a, b, c, w[2], 0xfcefa3f8, 9)
+	STEP(G, c, d, a, b, w[7], 0x676f02d9, 14)
+	STEP(G, b, c, d, a, w[12], 0x8d2a4c8a, 20)
+	
+	STEP(H, a, b, c, d, w[5], 0xfffa3942, 4)
+	STEP(H, d, a, b, c, w[8], 0x8771f681, 11)
+	STEP(H, c, d, a, b, w[11], 0x6d9d6122, 16)
+	STEP(H, b, c, d, a, w[14], 0xfde5380c, 23)
+	STEP(H, a, b, c, d, w[1], 0xa4beea44, 4)
+	STEP(H, d, a, b, c, w[4], 0x4bdecfa9, 11)
+	STEP(H, c, d, a, b, w[7], 0xf6bb4b60, 16)
+	STEP(H, b, c, d, a, w[10], 0xbebfbc70, 23)
+	STEP(H, a, b, c, d, w[13], 0x289b7ec6, 4)
+	STEP(H, d, a, b, c, w[0], 0xeaa127fa, 11)
+	STEP(H, c, d, a, b, w[3], 0xd4ef3085, 16)
+	STEP(H, b, c, d, a, w[6], 0x04881d05, 23)
+	STEP(H, a, b, c, d, w[9], 0xd9d4d039, 4)
+	STEP(H, d, a, b, c, w[12], 0xe6db99e5, 11)
+	STEP(H, c, d, a, b, w[15], 0x1fa27cf8, 16)
+	STEP(H, b, c, d, a, w[2], 0xc4ac5665, 23)
+	
+	STEP(I, a, b, c, d, w[0], 0xf4292244, 6)
+	STEP(I, d, a, b, c, w[7], 0x432aff97, 10)
+	STEP(I, c, d, a, b, w[14], 0xab9423a7, 15)
+	STEP(I, b, c, d, a, w[5], 0xfc93a039, 21)
+	STEP(I, a, b, c, d, w[12], 0x655b59c3, 6)
+	STEP(I, d, a, b, c, w[3], 0x8f0ccc92, 10)
+	STEP(I, c, d, a, b, w[10], 0xffeff47d, 15)
+	STEP(I, b, c, d, a, w[1], 0x85845dd1, 21)
+	STEP(I, a, b, c, d, w[8], 0x6fa87e4f, 6)
+	STEP(I, d, a, b, c, w[15], 0xfe2ce6e0, 10)
+	STEP(I, c, d, a, b, w[6], 0xa3014314, 15)
+	STEP(I, b, c, d, a, w[13], 0x4e0811a1, 21)
+	STEP(I, a, b, c, d, w[4], 0xf7537e82, 6)
+	STEP(I, d, a, b, c, w[11], 0xbd3af235, 10)
+	STEP(I, c, d, a, b, w[2], 0x2ad7d2bb, 15)
+	STEP(I, b, c, d, a, w[9], 0xeb86d391, 21)
+	
+	ctx->state[0] += a;
+	ctx->state[1] += b;
+	ctx->state[2] += c;
+	ctx->state[3] += d;
+}
+
+void md5_init(md5_context *ctx)
+{
+	ctx->state[0] = 0x67452301;
+	ctx->state[1] = 0xefcdab89;
+	ctx->state[2] = 0x98badcfe;
+	ctx->state[3] = 0x10325476;
+	ctx->length = 0;
+}
+
+void md5_update(md5_context *ctx, const uint8_t *data, uint32_t size)
+{
+	uint32_t used = ctx->length & 63;
+	ctx->length += size;
+	if (used) {
+		uint32_t fill = 64 - used;
+		if (size < fill) {
+			memcpy(ctx->block + used, data, size);
+			return;
+		}
+		memcpy(ctx->block + used, data, fill);
+		md5_block(ctx, ctx->block);
+		data += fill;
+		size -= fill;
+	}
+	for (; size >= 64; size -= 64, data += 64)
+	{
+		md5_block(ctx, data);
+	}
+	memcpy(ctx->block, data, size);
+}
+
+void md5_final(md5_context *ctx, uint8_t *digest)
+{
+	uint64_t bits = ctx->length * 8;
+	uint32_t used = ctx->length & 63;
+	ctx->block[used++] = 0x80;
+	if (used > 56) {
+		memset(ctx->block + used, 0, 64 - used);
+		md5_block(ctx, ctx->block);
+		used = 0;
+	}
+	memset(ctx->block + used, 0, 56 - used);
+	for (int i = 0; i < 8; i++)
+	{
+		ctx->block[56 + i] = bits >> (i * 8);
+	}
+	md5_block(ctx, ctx->block);
+	for (int i = 0; i < 16; i++)
+	{
+		digest[i] = ctx->state[i >> 2] >> ((i & 3) * 8);
+	}
+}
+
+void md5_to_hex(const uint8_t *digest, char *out)
+{
+	static const char digits[] = "0123456789abcdef";
+	for (int i = 0; i < MD5_DIGEST_SIZE; i++)
+	{
+		*(out++) = digits[digest[i] >> 4];
+		*(out++) = digits[digest[i] & 0xF];
+	}
+	*out = 0;
+}
@@ -0,0 +1,24 @@
+/*
+ Copyright 2018 Michael Pavone
+ This file is part of retron_dump.
+ retron_dump is free software distributed under the terms of the GNU General Public License version 3 or greater. See LICENSE for full license text.
+*/
+#ifndef MD5_H_
+#define MD5_H_
+
+#include <stdint.h>
+
+#define MD5_DIGEST_SIZE 16
+
+typedef struct {
+	uint32_t state[4];
+	uint64_t length;
+	uint8_t  block[64];
+} md5_context;
+
+void md5_init(md5_context *ctx);
+void md5_update(md5_context *ctx, const uint8_t *data, uint32_t size);
+void md5_final(md5_context *ctx, uint8_t *digest);
+void md5_to_hex(const uint8_t *digest, char *out);
+
+#endif //MD5_H_
@@ -0,0 +1,126 @@
+/*
+ Copyright 2018 Michael Pavone
+ This file is part of retron_dump.
+ retron_dump is free software distributed under the terms of the GNU General Public License version 3 or greater. See LICENSE for full license text.
+*/
+#include <string.h>
+#include "sha1.h"
+
+#define ROL(x, n) ((x) << (n) | (x) >> (32 - (n)))
+
+//w is a 16 word ring so the schedule stays in registers/cache
+#define W(i) ((i) < 16 ? w[(i)] : (w[(i) & 15] = ROL(w[((i)-3) & 15] ^ w[((i)-8) & 15] ^ w[((i)-14) & 15] ^ w[(i) & 15], 1)))
+#define F1(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define F2(b, c, d) ((b) ^ (c) ^ (d))
+#define F3(b, c, d) (((b) & (c)) | ((d) & ((b) | (c))))
+#define STEP(f, k, a, b, c, d, e, i) \
+	e += ROL(a, 5) + f(b, c, d) + k + W(i); \
+	b = ROL(b, 30);
+//five steps rotate the roles of the working variables back to where they started
+#define STEP5(f, k, i) \
+	STEP(f, k, a, b, c, d, e, i) \
+	STEP(f, k, e, a, b, c, d, i+1) \
+	STEP(f, k, d, e, a, b, c, i+2) \
+	STEP(f, k, c, d, e, a, b, i+3) \
+	STEP(f, k, b, c, d, e, a, i+4)
+
+static void sha1_block(sha1_context *ctx, const uint8_t *block)
+{
+	uint32_t w[16];
+	for (int i = 0; i < 16; i++)
+	{
+		w[i] = (uint32_t)block[i*4] << 24 | block[i*4+1] << 16 | block[i*4+2] << 8 | block[i*4+3];
+	}
+	uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3], e = ctx->state[4];
+	
+	STEP5(F1, 0x5A827999, 0)
+	STEP5(F1, 0x5A827999, 5)
+	STEP5(F1, 0x5A827999, 10)
+	STEP5(F1, 0x5A827999, 15)
+	
+	STEP5(F2, 0x6ED9EBA1, 20)
+	STEP5(F2, 0x6ED9EBA1, 25)
+	STEP5(F2, 0x6ED9EBA1, 30)
+	STEP5(F2, 0x6ED9EBA1, 35)
+	
+	STEP5(F3, 0x8F1BBCDC, 40)
+	STEP5(F3, 0x8F1BBCDC, 45)
+	STEP5(F3, 0x8F1BBCDC, 50)
+	STEP5(F3, 0x8F1BBCDC, 55)
+	
+	STEP5(F2, 0xCA62C1D6, 60)
+	STEP5(F2, 0xCA62C1D6, 65)
+	STEP5(F2, 0xCA62C1D6, 70)
+	STEP5(F2, 0xCA62C1D6, 75)
+	
+	ctx->state[0] += a;
+	ctx->state[1] += b;
+	ctx->state[2] += c;
+	ctx->state[3] += d;
+	ctx->state[4] += e;
+}
+
+void sha1_init(sha1_context *ctx)
+{
+	ctx->state[0] = 0x67452301;
+	ctx->state[1] = 0xEFCDAB89;
+	ctx->state[2] = 0x98BADCFE;
+	ctx->state[3] = 0x10325476;
+	ctx->state[4] = 0xC3D2E1F0;
+	ctx->length = 0;
+}
+
+void sha1_update(sha1_context *ctx, const uint8_t *data, uint32_t size)
+{
+	uint32_t used = ctx->length & 63;
+	ctx->length += size;
+	if (used) {
+		uint32_t fill = 64 - used;
+		if (size < fill) {
+			memcpy(ctx->block + used, data, size);
+			return;
+		}
+		memcpy(ctx->block + used, data, fill);
+		sha1_block(ctx, ctx->block);
+		data += fill;
+		size -= fill;
+	}
+	for (; size >= 64; size -= 64, data += 64)
+	{
+		sha1_block(ctx, data);
+	}
+	memcpy(ctx->block, data, size);
+}
+
+void sha1_final(sha1_context *ctx, uint8_t *digest)
+{
+	uint64_t bits = ctx->length * 8;
+	uint32_t used = ctx->length & 63;
+	ctx->block[used++] = 0x80;
+	if (used > 56) {
+		memset(ctx->block + used, 0, 64 - used);
+		sha1_block(ctx, ctx->block);
+		used = 0;
+	}
+	memset(ctx->block + used, 0, 56 - used);
+	for (int i = 0; i < 8; i++)
+	{
+		ctx->block[63 - i] = bits >> (i * 8);
+	}
+	sha1_block(ctx, ctx->block);
+	for (int i = 0; i < SHA1_DIGEST_SIZE; i++)
+	{
+		digest[i] = ctx->state[i >> 2] >> ((3 - (i & 3)) * 8);
+	}
+}
+
+void sha1_to_hex(const uint8_t *digest, char *out)
+{
+	static const char digits[] = "0123456789abcdef";
+	for (int i = 0; i < SHA1_DIGEST_SIZE; i++)
+	{
+		*(out++) = digits[digest[i] >> 4];
+		*(out++) = digits[digest[i] & 0xF];
+	}
+	*out = 0;
+}
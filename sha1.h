@@ -0,0 +1,24 @@
+/*
+ Copyright 2018 Michael Pavone
+ This file is part of retron_dump.
+ retron_dump is free software distributed under the terms of the GNU General Public License version 3 or greater. See LICENSE for full license text.
+*/
+#ifndef SHA1_H_
+#define SHA1_H_
+
+#include <stdint.h>
+
+#define SHA1_DIGEST_SIZE 20
+
+typedef struct {
+	uint32_t state[5];
+	uint64_t length;
+	uint8_t  block[64];
+} sha1_context;
+
+void sha1_init(sha1_context *ctx);
+void sha1_update(sha1_context *ctx, const uint8_t *data, uint32_t size);
+void sha1_final(sha1_context *ctx, uint8_t *digest);
+void sha1_to_hex(const uint8_t *digest, char *out);
+
+#endif //SHA1_H_